@@ -13,17 +13,31 @@
 #else
 #include <netinet/ip.h>
 #include <netinet/in.h>
+#include <netinet/icmp6.h>
+#include <sys/socket.h>
 #include <arpa/inet.h>
 #include <time.h>
 #include <errno.h>
 #include <netdb.h>
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <linux/filter.h>
+#include <sys/mman.h>
+#include <poll.h>
+#endif
 #include <sys/types.h>
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <thread>
 #include <cstring>
+#include <deque>
+#include <utility>
 
 #if 0 //DEBUG
 #include <cstdio>
@@ -50,9 +64,10 @@
  * https://github.com/matt-kimball/mtr/blob/master/packet/construct_unix.c
  * https://stackoverflow.com/questions/9913661/what-is-the-proper-process-for-icmp-echo-request-reply-on-unreachable-destinatio
  * https://stackoverflow.com/questions/43239862/socket-sock-raw-ipproto-icmp-cant-read-ttl-response
+ * https://tools.ietf.org/html/rfc4443
  *
  */
- 
+
 /* For Mac OS X and FreeBSD */
 #ifndef SOL_IP
 	#define SOL_IP IPPROTO_IP
@@ -67,6 +82,14 @@
 /*  ICMP_DEST_UNREACH codes */
 #define ICMP_PORT_UNREACH 3
 
+/*  ICMPv6 type codes  */
+#ifndef ICMP6_ECHO_REQUEST
+#define ICMP6_ECHO_REQUEST 128
+#endif
+#ifndef ICMP6_ECHO_REPLY
+#define ICMP6_ECHO_REPLY 129
+#endif
+
 struct ICMPHeader {
     uint8_t type;
     uint8_t code;
@@ -90,17 +113,311 @@ struct ipHeader {
     struct  in_addr ip_src,ip_dst;  /* source and dest address */
 };
 
+struct ip6Header {
+    uint32_t ip6_flow;      /* version, traffic class, flow label */
+    uint16_t ip6_plen;      /* payload length */
+    uint8_t  ip6_nxt;       /* next header */
+    uint8_t  ip6_hlim;      /* hop limit */
+    struct   in6_addr ip6_src,ip6_dst;  /* source and dest address */
+};
+
 
 #define MAX_ICMP_SIZE (16 * 1024)
 
+/*  Flood mode limits */
+#define FLOOD_MAX_WINDOW 4096
+#define FLOOD_MAX_LOSS 5.       // percent, auto-tune stops above it
+#define FLOOD_MIN_GAIN 1.05     // auto-tune stops when pps grows less
+#define FLOOD_TIMEOUT_MS 1000   // echo timeout until the first window is answered, and its upper bound
+#define FLOOD_TIMEOUT_MIN_MS 5  // adaptive echo timeout floor
+#define FLOOD_TIMEOUT_RUN_DIV 4 // adaptive echo timeout stays below run duration / it
+#define FLOOD_BASE_MS 250       // unloaded window 1 run, rtt_inflation is relative to it
+#define FLOOD_POLL_MS 10        // wait for replies while the window is full
+#define FLOOD_SKB_OVERHEAD 1024 // kernel accounting per queued reply on top of its size
+
+/*  AF_PACKET TPACKET_V3 receive ring */
+#define RING_BLOCK_SIZE (1 << 18)
+#define RING_BLOCK_NR 16
+#define RING_FRAME_SIZE 2048
+#define RING_FILTER_MAX 16      // BPF instructions in a reply filter
+#define RING_BLOCK_TOV_MS 1     // kernel hands over a partially filled block after it
+/*  Replies reach userspace only when a block retires, so the closed loop is capped
+ *  at about window / RING_BLOCK_TOV_MS; auto-tune with the ring starts from here.  */
+#define RING_MIN_WINDOW 256
+
+#ifdef __WIN32__
+typedef SOCKET socket_t;
+#else
+typedef int socket_t;
+#endif
+
+/*  Add a buffer to a running one's complement sum, bytes are taken as big-endian pairs.  */
+static uint32_t checksum_add(const void *data, int size, uint32_t sum)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+    for (int i = 0; i < size; i++) {
+        if ((i & 1) == 0) {
+            sum += bytes[i] << 8;
+        } else {
+            sum += bytes[i];
+        }
+    }
+    return sum;
+}
+
+static uint16_t checksum_fold(uint32_t sum)
+{
+    /* Sums which overflow a 16-bit value have the high bits added back into the low 16 bits. */
+    while (sum >> 16) {
+        sum = (sum >> 16) + (sum & 0xffff);
+    }
+
+    /* The value stored is the one's complement of the mathematical sum. */
+    return (~sum & 0xffff);
+}
+
+/*!
+ * \brief Address family traits
+ *
+ * dev_ping::Impl send, parse and match code is templated on them,
+ * so every family gets its own hot path and the family is chosen once per check or flood run.
+ */
+struct af_inet {
+    typedef sockaddr_in sockaddr_type;
+    typedef in_addr     addr_type;
+    enum {
+        family          = AF_INET,
+        proto           = IPPROTO_ICMP,
+        echo_request    = ICMP_ECHO,
+        echo_reply      = ICMP_ECHOREPLY,
+    };
+
+    static const addr_type &addr(const sockaddr_type &sa) { return sa.sin_addr; }
+    static bool same(const addr_type &a, const addr_type &b) { return a.s_addr == b.s_addr; }
+
+    /*  ICMPv4 checksum covers the ICMP message only.  */
+    static uint16_t checksum(const sockaddr_type &, const sockaddr_type &, const void *packet, int size)
+    {
+        return checksum_fold(checksum_add(packet, size, 0));
+    }
+
+    static bool set_dont_fragment(socket_t sock)
+    {
+#ifdef __WIN32__
+        int val = 1;
+        return setsockopt(sock, SOL_IP, IP_DONTFRAGMENT, (char *)&val, sizeof(val)) >= 0;
+#else
+#ifdef __APPLE__
+        int val = 1;
+        return setsockopt(sock, SOL_IP, IP_HDRINCL, (char *)&val, sizeof(val)) >= 0;
+#else // UNIX
+        int val = IP_PMTUDISC_DO;
+        return setsockopt(sock, SOL_IP, IP_MTU_DISCOVER , &val, sizeof(val)) >= 0;
+#endif // __APPLE__
+#endif // __WIN32__
+    }
+
+    static bool set_recv_options(socket_t) { return true; }
+
+    /*  Packet starts at the IP header, return ICMP header or nullptr.  */
+    static const char *parse_network(const char *data, int *len, addr_type *from, uint8_t *ttl)
+    {
+        if (*len < (int)sizeof(ipHeader)) return nullptr;
+
+        const ipHeader *ip = (const ipHeader *)data;
+        int iphdrlen = ip->ip_hl << 2;
+
+        *len    -= iphdrlen;
+        *from   = ip->ip_src;
+        *ttl    = ip->ip_ttl;
+        return &data[iphdrlen];
+    }
+
+    /*  Raw ICMPv4 socket delivers the IP header too.  */
+    static const char *parse_socket(const char *data, int *len, const sockaddr_type &, int, addr_type *from, uint8_t *ttl)
+    {
+        return parse_network(data, len, from, ttl);
+    }
+
+#ifdef __linux__
+    enum { ether_type = ETH_P_IP };
+
+    // keep only ICMP echo replies with our id, offsets start at the IP header
+    static unsigned short ring_filter(uint16_t ident, sock_filter *code)
+    {
+        const sock_filter prog[] = {
+            { 0x30, 0, 0, 0x00000009 },     // ldb [9]
+            { 0x15, 0, 6, IPPROTO_ICMP },   // jne #IPPROTO_ICMP, drop
+            { 0xb1, 0, 0, 0x00000000 },     // ldxb 4*([0]&0xf)
+            { 0x50, 0, 0, 0x00000000 },     // ldb [x + 0]
+            { 0x15, 0, 3, ICMP_ECHOREPLY }, // jne #ICMP_ECHOREPLY, drop
+            { 0x48, 0, 0, 0x00000004 },     // ldh [x + 4]
+            { 0x15, 0, 1, ident },          // jne #ident, drop
+            { 0x06, 0, 0, 0x0000ffff },     // ret #0xffff
+            { 0x06, 0, 0, 0x00000000 },     // drop: ret #0
+        };
+        memcpy(code, prog, sizeof(prog));
+        return sizeof(prog) / sizeof(prog[0]);
+    }
+
+    // the same for the raw socket, it sees the IP header too
+    static unsigned short socket_filter(uint16_t ident, sock_filter *code)
+    {
+        const sock_filter prog[] = {
+            { 0xb1, 0, 0, 0x00000000 },     // ldxb 4*([0]&0xf)
+            { 0x50, 0, 0, 0x00000000 },     // ldb [x + 0]
+            { 0x15, 0, 3, ICMP_ECHOREPLY }, // jne #ICMP_ECHOREPLY, drop
+            { 0x48, 0, 0, 0x00000004 },     // ldh [x + 4]
+            { 0x15, 0, 1, ident },          // jne #ident, drop
+            { 0x06, 0, 0, 0x0000ffff },     // ret #0xffff
+            { 0x06, 0, 0, 0x00000000 },     // drop: ret #0
+        };
+        memcpy(code, prog, sizeof(prog));
+        return sizeof(prog) / sizeof(prog[0]);
+    }
+#endif
+};
+
+struct af_inet6 {
+    typedef sockaddr_in6 sockaddr_type;
+    typedef in6_addr     addr_type;
+    enum {
+        family          = AF_INET6,
+        proto           = IPPROTO_ICMPV6,
+        echo_request    = ICMP6_ECHO_REQUEST,
+        echo_reply      = ICMP6_ECHO_REPLY,
+    };
+
+    static const addr_type &addr(const sockaddr_type &sa) { return sa.sin6_addr; }
+    static bool same(const addr_type &a, const addr_type &b) { return memcmp(&a, &b, sizeof(addr_type)) == 0; }
+
+    /*  ICMPv6 checksum also covers a pseudo-header: addresses, length and next header (RFC 4443 2.3).  */
+    static uint16_t checksum(const sockaddr_type &src, const sockaddr_type &dst, const void *packet, int size)
+    {
+        uint32_t length = htonl(size);
+        uint8_t  next[4] = { 0, 0, 0, IPPROTO_ICMPV6 };
+
+        uint32_t sum = checksum_add(&src.sin6_addr, sizeof(addr_type), 0);
+        sum = checksum_add(&dst.sin6_addr, sizeof(addr_type), sum);
+        sum = checksum_add(&length, sizeof(length), sum);
+        sum = checksum_add(next, sizeof(next), sum);
+        return checksum_fold(checksum_add(packet, size, sum));
+    }
+
+    static bool set_dont_fragment(socket_t sock)
+    {
+#if defined(IPV6_MTU_DISCOVER) && !defined(__WIN32__) // Windows SDK has IPV6_MTU_DISCOVER, but not IPV6_PMTUDISC_DO
+        int val = IPV6_PMTUDISC_DO;
+        return setsockopt(sock, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &val, sizeof(val)) >= 0;
+#elif defined(IPV6_DONTFRAG)
+        int val = 1;
+        return setsockopt(sock, IPPROTO_IPV6, IPV6_DONTFRAG, (char *)&val, sizeof(val)) >= 0;
+#else
+        (void)sock;
+        return true;
+#endif
+    }
+
+    /*  Hop limit comes as ancillary data, other ICMPv6 types are not queued at all.  */
+    static bool set_recv_options(socket_t sock)
+    {
+#ifdef IPV6_RECVHOPLIMIT
+        int val = 1;
+        if (setsockopt(sock, IPPROTO_IPV6, IPV6_RECVHOPLIMIT, (char *)&val, sizeof(val)) < 0) return false;
+#endif
+#ifdef ICMP6_FILTER
+        icmp6_filter filter;
+        ICMP6_FILTER_SETBLOCKALL(&filter);
+        ICMP6_FILTER_SETPASS(ICMP6_ECHO_REPLY, &filter);
+        if (setsockopt(sock, IPPROTO_ICMPV6, ICMP6_FILTER, (char *)&filter, sizeof(filter)) < 0) return false;
+#endif
+        (void)sock;
+        return true;
+    }
+
+    /*  Packet starts at the IPv6 header, extension headers are not followed.  */
+    static const char *parse_network(const char *data, int *len, addr_type *from, uint8_t *ttl)
+    {
+        if (*len < (int)sizeof(ip6Header)) return nullptr;
+
+        const ip6Header *ip6 = (const ip6Header *)data;
+        if (ip6->ip6_nxt != IPPROTO_ICMPV6) return nullptr;
+
+        *len    -= sizeof(ip6Header);
+        *from   = ip6->ip6_src;
+        *ttl    = ip6->ip6_hlim;
+        return &data[sizeof(ip6Header)];
+    }
+
+    /*  Raw ICMPv6 socket delivers the ICMP message only.  */
+    static const char *parse_socket(const char *data, int *, const sockaddr_type &sa, int hoplimit, addr_type *from, uint8_t *ttl)
+    {
+        *from   = sa.sin6_addr;
+        *ttl    = (uint8_t)hoplimit;
+        return data;
+    }
+
+#ifdef __linux__
+    enum { ether_type = ETH_P_IPV6 };
+
+    // keep only ICMPv6 echo replies with our id and without extension headers, offsets start at the IPv6 header
+    static unsigned short ring_filter(uint16_t ident, sock_filter *code)
+    {
+        const sock_filter prog[] = {
+            { 0x30, 0, 0, 0x00000006 },         // ldb [6]
+            { 0x15, 0, 5, IPPROTO_ICMPV6 },     // jne #IPPROTO_ICMPV6, drop
+            { 0x30, 0, 0, 0x00000028 },         // ldb [40]
+            { 0x15, 0, 3, ICMP6_ECHO_REPLY },   // jne #ICMP6_ECHO_REPLY, drop
+            { 0x28, 0, 0, 0x0000002c },         // ldh [44]
+            { 0x15, 0, 1, ident },              // jne #ident, drop
+            { 0x06, 0, 0, 0x0000ffff },         // ret #0xffff
+            { 0x06, 0, 0, 0x00000000 },         // drop: ret #0
+        };
+        memcpy(code, prog, sizeof(prog));
+        return sizeof(prog) / sizeof(prog[0]);
+    }
+
+    // raw ICMPv6 socket filter sees the ICMPv6 header only
+    static unsigned short socket_filter(uint16_t ident, sock_filter *code)
+    {
+        const sock_filter prog[] = {
+            { 0x30, 0, 0, 0x00000000 },         // ldb [0]
+            { 0x15, 0, 3, ICMP6_ECHO_REPLY },   // jne #ICMP6_ECHO_REPLY, drop
+            { 0x28, 0, 0, 0x00000004 },         // ldh [4]
+            { 0x15, 0, 1, ident },              // jne #ident, drop
+            { 0x06, 0, 0, 0x0000ffff },         // ret #0xffff
+            { 0x06, 0, 0, 0x00000000 },         // drop: ret #0
+        };
+        memcpy(code, prog, sizeof(prog));
+        return sizeof(prog) / sizeof(prog[0]);
+    }
+#endif
+};
+
+template<class AF>
+struct echo_reply {
+    uint8_t     type;       // icmp type
+    uint16_t    id;         // id proccess
+    uint16_t    seq;        // sequence number
+    uint16_t    len;        // lenght of icmp packet
+    uint8_t     ttl;        // time to live / hop limit
+    uint64_t    time_send;  // timestamp from echo payload
+    typename AF::addr_type from; // source address
+};
+
 class dev_ping::Impl
 {
 private:
     uint16_t    m_ping_seq_num = 0;
-    sockaddr_in m_dest_addr;
-    sockaddr_in m_from_addr;
+    uint16_t    m_ident;
+    sockaddr_storage m_dest_addr;
+    sockaddr_storage m_src_addr;    // local address toward m_dest_addr, for ICMPv6 checksum
+    sockaddr_storage m_from_addr;
+    std::string m_dest_str;         // m_dest_addr as text
     char m_send_packet[MAX_ICMP_SIZE];
     char m_recv_packet[MAX_ICMP_SIZE];
+    std::vector<uint64_t> m_flood_sent; // send time by sequence number, 0 - not in flight
 
     bool socket_is_init     = false;
     bool host_is_resolve    = false;
@@ -112,29 +429,110 @@ private:
 #else
     int sock = -1;
 #endif
-    bool getsockaddr(const char * host, struct sockaddr_in* sockaddr);
 
-    /*  Compute the IP checksum (or ICMP checksum) of a packet.  */
-    static uint16_t compute_checksum(const void *packet, int size);
+    bool ring_is_init       = false;
+#ifdef __linux__
+    int ring_sock           = -1;
+    uint8_t *ring_map       = nullptr;
+    uint32_t ring_block     = 0;    // next block to read
+    int64_t ring_clock_offset = 0;  // time_now() - CLOCK_REALTIME of kernel timestamps
+#endif
+
+    bool getsockaddr(const char * host, struct sockaddr_storage* sockaddr);
+    void source_resolve();
+
+    template<class AF> typename AF::sockaddr_type &dest_addr() { return *reinterpret_cast<typename AF::sockaddr_type *>(&m_dest_addr); }
+    template<class AF> typename AF::sockaddr_type &src_addr() { return *reinterpret_cast<typename AF::sockaddr_type *>(&m_src_addr); }
+
+    int packet_size() const;
+    /*  Build and send one echo request, return bytes sent.  */
+    template<class AF> int send_echo(uint16_t seq, uint64_t *time_send = nullptr);
+    /*  Parse ICMP header found by AF::parse_socket() or AF::parse_network().  */
+    template<class AF> static bool parse_reply(const char *icmp, int len, echo_reply<AF> *reply);
+
+    /*  Wait for received packets and pass each parsed one to on_reply(reply, time_recv),
+     *  return number of packets or -1 on error.  */
+    template<class AF, class F> int sock_recv(uint32_t timeout_ms, F on_reply);
+    template<class AF, class F> int ring_recv(uint32_t timeout_ms, F on_reply);
 
 public:
-    Impl()
-    {
-    }
+    Impl();
     virtual ~Impl() {
         deinit();
     };
     std::string status;
     uint16_t    m_ping_size_payload = 32;
+    bool        m_use_ring = false;
+    bool        m_status_text = true;
+    uint32_t    m_flood_timeout_ms = 0; // 0 - adaptive
+    int         m_family_pref = AF_UNSPEC;
+    int         m_family = AF_INET;     // family of the resolved host
 
     bool init();
-    bool init_socket();
+    template<class AF> bool init_socket();
+    template<class AF> bool init_ring();
+    void set_recv_buffer(uint32_t window);
     bool host_resolve(const std::string &hostname);
-    bool send_icmp();
-    bool recv_icmp(uint32_t timeout_ms, result_t *result = nullptr);
+    template<class AF> bool send_icmp();
+    void send_result(result_t *result) const;
+    template<class AF> bool recv_icmp(uint32_t timeout_ms, result_t *result = nullptr);
+    template<class AF> bool flood_run(uint32_t window, uint32_t duration_ms, flood_result_t *result);
     bool deinit();
 };
 
+static uint64_t time_now()
+{
+#ifdef __WIN32__
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*  Seconds between two time_now() values.  */
+static double time_diff(uint64_t from, uint64_t to)
+{
+#ifdef __WIN32__
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+    return (int64_t)(to - from) / (double)Frequency.QuadPart;
+#else
+    return (int64_t)(to - from) / 1000000000.;
+#endif
+}
+
+static uint16_t get_pid()
+{
+#ifdef _MSC_VER
+    return _getpid() & 0xFFFF;
+#else
+    return getpid() & 0xFFFF;
+#endif
+}
+
+static std::string addr_to_string(const sockaddr_storage &sa)
+{
+    char host[NI_MAXHOST];
+    socklen_t len = sa.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    if (getnameinfo((const sockaddr *)&sa, len, host, sizeof(host), NULL, 0, NI_NUMERICHOST) != 0) {
+        return std::string();
+    }
+    return host;
+}
+
+dev_ping::Impl::Impl()
+{
+    // several dev_ping in one process must not take each other's replies
+    static std::atomic<uint16_t> instance {0};
+    m_ident = get_pid() + instance++;
+
+    memset(static_cast<void *>(&m_dest_addr), 0, sizeof(m_dest_addr));
+    memset(static_cast<void *>(&m_src_addr), 0, sizeof(m_src_addr));
+    memset(static_cast<void *>(&m_from_addr), 0, sizeof(m_from_addr));
+}
+
 dev_ping::dev_ping()
     : impl(std::make_unique<Impl>())
 {
@@ -166,17 +564,81 @@ bool dev_ping::check(result_t *result)
         result->ip_ttl      = 0;
         result->rtt         = 0;
         result->from_addr.clear();
+        result->to_addr.clear();
+        result->send_id     = 0;
+        result->send_seq    = 0;
+        result->send_len    = 0;
+        result->send_status = 0;
         result->status.clear();
     }
     EC_ASSERT(impl->init());
-    EC_ASSERT(impl->init_socket());
     EC_ASSERT(impl->host_resolve(m_hostname));
-    EC_ASSERT(impl->send_icmp());
-    EC_ASSERT(impl->recv_icmp(3000, result));
+    if (impl->m_family == AF_INET6) {
+        EC_ASSERT(impl->init_socket<af_inet6>());
+        EC_ASSERT(impl->send_icmp<af_inet6>());
+        impl->send_result(result);
+        EC_ASSERT(impl->recv_icmp<af_inet6>(3000, result));
+    }
+    else {
+        EC_ASSERT(impl->init_socket<af_inet>());
+        EC_ASSERT(impl->send_icmp<af_inet>());
+        impl->send_result(result);
+        EC_ASSERT(impl->recv_icmp<af_inet>(3000, result));
+    }
     EC_ASSERT(impl->deinit());
     return true;
 }
 
+bool dev_ping::flood(uint32_t window, uint32_t duration_ms, std::vector<flood_result_t> *results, std::string *status)
+{
+    if (results) results->clear();
+    if (window > FLOOD_MAX_WINDOW) window = FLOOD_MAX_WINDOW;
+
+    bool ok = impl->init() && impl->host_resolve(m_hostname);
+    bool inet6 = impl->m_family == AF_INET6;
+    if (ok) ok = inet6 ? impl->init_socket<af_inet6>() : impl->init_socket<af_inet>();
+    if (ok) impl->set_recv_buffer(window ? window : FLOOD_MAX_WINDOW);
+    if (ok && impl->m_use_ring) ok = inet6 ? impl->init_ring<af_inet6>() : impl->init_ring<af_inet>();
+
+    uint32_t w = window ? window : (impl->m_use_ring ? RING_MIN_WINDOW : 1);
+    if (ok && impl->m_use_ring && window && window < RING_MIN_WINDOW) {
+        impl->status.append("Ping:        Flood window " + std::to_string(window) + " is below " + std::to_string(RING_MIN_WINDOW)
+                            + ", receive ring caps pps at about window * " + std::to_string(1000 / RING_BLOCK_TOV_MS) + "\n");
+    }
+    // rtt_inflation is relative to an unloaded window 1 run, auto-tune without the ring starts with it
+    double rtt_base = 0;
+    if (ok && w > 1) {
+        flood_result_t base;
+        ok = inet6 ? impl->flood_run<af_inet6>(1, std::min<uint32_t>(duration_ms, FLOOD_BASE_MS), &base)
+                   : impl->flood_run<af_inet>(1, std::min<uint32_t>(duration_ms, FLOOD_BASE_MS), &base);
+        if (ok) rtt_base = base.rtt_avg;
+        else impl->deinit();
+    }
+    double pps_prev = 0;
+    while (ok) {
+        flood_result_t r;
+        r.window = w;
+        if (!(inet6 ? impl->flood_run<af_inet6>(w, duration_ms, &r) : impl->flood_run<af_inet>(w, duration_ms, &r))) {
+            impl->deinit();
+            ok = false;
+            break;
+        }
+        if (w == 1 && rtt_base == 0) rtt_base = r.rtt_avg;
+        r.rtt_inflation = rtt_base > 0 ? r.rtt_avg / rtt_base : 0;
+        if (results) results->push_back(r);
+
+        // auto-tune: stop when a wider window gives no more throughput or starts to lose echoes
+        if (window || w >= FLOOD_MAX_WINDOW || r.loss > FLOOD_MAX_LOSS) break;
+        if (pps_prev > 0 && r.pps < pps_prev * FLOOD_MIN_GAIN) break;
+        pps_prev = r.pps;
+        w *= 2;
+    }
+    if (ok) ok = impl->deinit();
+
+    if (status) status->append(impl->status);
+    return ok;
+}
+
 void dev_ping::setSize(uint16_t size)
 {
     if (size > 16 && size < MAX_ICMP_SIZE) {
@@ -184,23 +646,40 @@ void dev_ping::setSize(uint16_t size)
     }
 }
 
-bool dev_ping::Impl::init_socket()
+void dev_ping::setRecvRing(bool enable)
 {
-    // get proto
-    protoent *protocol = getprotobyname("icmp");
-    if (protocol == NULL) {
-        status.append("Ping:        Failed to getprotobyname!\n");
-        deinit();
-        return false;
+    impl->m_use_ring = enable;
+}
+
+void dev_ping::setFloodTimeout(uint32_t timeout_ms)
+{
+    impl->m_flood_timeout_ms = timeout_ms;
+}
+
+void dev_ping::setStatusText(bool enable)
+{
+    impl->m_status_text = enable;
+}
+
+void dev_ping::setFamily(family_t family)
+{
+    switch (family) {
+        case FAMILY_INET:   impl->m_family_pref = AF_INET; break;
+        case FAMILY_INET6:  impl->m_family_pref = AF_INET6; break;
+        default:            impl->m_family_pref = AF_UNSPEC; break;
     }
+}
 
+template<class AF>
+bool dev_ping::Impl::init_socket()
+{
 #ifdef __APPLE__
     int type = SOCK_DGRAM;
 #else
     int type = SOCK_RAW;
 #endif
 
-    sock = socket(AF_INET, type, protocol->p_proto); /*IPPROTO_ICMP*/
+    sock = socket(AF::family, type, AF::proto);
     if (sock < 0) {
         status.append("Ping:        Failed to create socket! ");
         status.append("Errno: " + std::string(std::to_string(errno)) + " - '" + std::string(std::strerror(errno)) + "'");
@@ -217,42 +696,43 @@ bool dev_ping::Impl::init_socket()
         return false;
     }
 
-#ifdef __WIN32__
-    int val = 1;
-    if (setsockopt(sock, SOL_IP, IP_DONTFRAGMENT, (char *)&val, sizeof(val)) < 0) {
-#else
-#ifdef __APPLE__
-    int val = 1;
-    if (setsockopt(sock, SOL_IP, IP_HDRINCL, (char *)&val, sizeof(val)) < 0) {
-#else // UNIX
-    int val = IP_PMTUDISC_DO;
-    if (setsockopt(sock, SOL_IP, IP_MTU_DISCOVER , &val, sizeof(val)) < 0) {
-#endif // __APPLE__
-#endif // __WIN32__
+    if (!AF::set_dont_fragment(sock)) {
         status.append("Ping:        Failed to setsockopt2!\n");
         deinit();
         return false;
     }
 
-//    struct timeval timeout;
-//    timeout.tv_sec  = 1;
-//    timeout.tv_usec = 0;
-
-//    if (setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, (char *)&timeout, sizeof(timeout)) < 0) {
-//        status.append("Ping:        Failed to setsockopt3!\n");
-//        deinit();
-//        return false;
-//    }
+    if (!AF::set_recv_options(sock)) {
+        status.append("Ping:        Failed to setsockopt3!\n");
+        deinit();
+        return false;
+    }
 
-//    if (setsockopt (sock, SOL_SOCKET, SO_SNDTIMEO, (char *)&timeout, sizeof(timeout)) < 0) {
-//        status.append("Ping:        Failed to setsockopt4!\n");
-//        deinit();
-//        return false;
-//    }
+#ifdef __linux__
+    // every raw socket gets a copy of every ICMP packet, let the kernel drop other dev_ping's replies
+    sock_filter code_reply[RING_FILTER_MAX];
+    sock_fprog filter_reply = { AF::socket_filter(m_ident, code_reply), code_reply };
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &filter_reply, sizeof(filter_reply)) < 0) {
+        status.append("Ping:        Failed to attach socket filter!\n");
+    }
+#endif
 
     return true;
 }
 
+/*  Receive queue for a whole flood window, so replies are not dropped by our own socket.  */
+void dev_ping::Impl::set_recv_buffer(uint32_t window)
+{
+    int size = (int)window * (packet_size() + FLOOD_SKB_OVERHEAD);
+#ifdef SO_RCVBUFFORCE
+    // beyond net.core.rmem_max, needs CAP_NET_ADMIN
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, (const char *)&size, sizeof(size)) == 0) return;
+#endif
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size)) < 0) {
+        status.append("Ping:        Failed to set flood receive buffer " + std::to_string(size) + "!\n");
+    }
+}
+
 bool dev_ping::Impl::host_resolve(const std::string &hostname)
 {
     // host resolve
@@ -261,13 +741,131 @@ bool dev_ping::Impl::host_resolve(const std::string &hostname)
         deinit();
         return false;
     }
+    m_family = m_dest_addr.ss_family;
+    if (m_family == AF_INET6) source_resolve();
 
-    status.append("Ping: hostname '" + hostname + "' (to ip: " + inet_ntoa(m_dest_addr.sin_addr) + /*", from self iface ip " + inet_ntoa(m_from_addr.sin_addr) +*/ ")\n");
+    m_dest_str = addr_to_string(m_dest_addr);
+    status.append("Ping: hostname '" + hostname + "' (to ip: " + m_dest_str + ")\n");
 
     host_is_resolve = true;
     return true;
 }
 
+/*  Local address the kernel picks toward m_dest_addr: connect() an UDP socket, nothing is sent.  */
+void dev_ping::Impl::source_resolve()
+{
+    memset(static_cast<void *>(&m_src_addr), 0, sizeof(m_src_addr));
+
+    socket_t udp = socket(m_dest_addr.ss_family, SOCK_DGRAM, 0);
+#ifdef __WIN32__
+    if (udp == INVALID_SOCKET) return;
+#else
+    if (udp < 0) return;
+#endif
+
+    sockaddr_storage dest = m_dest_addr;
+    socklen_t dest_len;
+    if (dest.ss_family == AF_INET6) {
+        ((sockaddr_in6 *)&dest)->sin6_port = htons(1025);
+        dest_len = sizeof(sockaddr_in6);
+    }
+    else {
+        ((sockaddr_in *)&dest)->sin_port = htons(1025);
+        dest_len = sizeof(sockaddr_in);
+    }
+
+    socklen_t len = sizeof(m_src_addr);
+    if (connect(udp, (const sockaddr *)&dest, dest_len) < 0
+     || getsockname(udp, (sockaddr *)&m_src_addr, &len) < 0) {
+        status.append("Ping:        Failed to find source address!\n");
+    }
+#ifdef __WIN32__
+    closesocket(udp);
+#else
+    close(udp);
+#endif
+}
+
+template<class AF>
+bool dev_ping::Impl::init_ring()
+{
+#ifdef __linux__
+    ring_sock = socket(AF_PACKET, SOCK_DGRAM, htons(AF::ether_type));
+    if (ring_sock < 0) {
+        status.append("Ping:        Failed to create packet socket! ");
+        status.append("Errno: " + std::string(std::to_string(errno)) + " - '" + std::string(std::strerror(errno)) + "'");
+        status.append("\n");
+        deinit();
+        return false;
+    }
+    ring_is_init = true;
+
+    sock_filter code_reply[RING_FILTER_MAX];
+    sock_fprog filter_reply = { AF::ring_filter(m_ident, code_reply), code_reply };
+    if (setsockopt(ring_sock, SOL_SOCKET, SO_ATTACH_FILTER, &filter_reply, sizeof(filter_reply)) < 0) {
+        status.append("Ping:        Failed to attach ring filter!\n");
+        deinit();
+        return false;
+    }
+
+#ifdef PACKET_IGNORE_OUTGOING
+    int val = 1;
+    setsockopt(ring_sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &val, sizeof(val)); // optional, kernel >= 4.20
+#endif
+
+    int version = TPACKET_V3;
+    if (setsockopt(ring_sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        status.append("Ping:        Failed to set TPACKET_V3!\n");
+        deinit();
+        return false;
+    }
+
+    tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size       = RING_BLOCK_SIZE;
+    req.tp_block_nr         = RING_BLOCK_NR;
+    req.tp_frame_size       = RING_FRAME_SIZE;
+    req.tp_frame_nr         = (RING_BLOCK_SIZE / RING_FRAME_SIZE) * RING_BLOCK_NR;
+    req.tp_retire_blk_tov   = RING_BLOCK_TOV_MS;
+    if (setsockopt(ring_sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        status.append("Ping:        Failed to set rx ring!\n");
+        deinit();
+        return false;
+    }
+
+    // ring pages are kernel memory and stay resident, no MAP_LOCKED and no RLIMIT_MEMLOCK dependency
+    void *map = mmap(NULL, (size_t)RING_BLOCK_SIZE * RING_BLOCK_NR, PROT_READ | PROT_WRITE, MAP_SHARED, ring_sock, 0);
+    if (map == MAP_FAILED) {
+        status.append("Ping:        Failed to mmap rx ring! ");
+        status.append("Errno: " + std::string(std::to_string(errno)) + " - '" + std::string(std::strerror(errno)) + "'");
+        status.append("\n");
+        deinit();
+        return false;
+    }
+    ring_map    = static_cast<uint8_t *>(map);
+    ring_block  = 0;
+
+    // kernel timestamps are CLOCK_REALTIME, bring them to time_now()
+    int64_t realtime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    ring_clock_offset = (int64_t)time_now() - realtime;
+
+    // replies are read from the ring, the raw socket is only for sending
+    sock_filter code_drop[] = {
+        { 0x06, 0, 0, 0x00000000 },     // ret #0
+    };
+    sock_fprog filter_drop = { 1, code_drop };
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &filter_drop, sizeof(filter_drop)) < 0) {
+        status.append("Ping:        Failed to attach drop filter, replies are queued on the raw socket too!\n");
+    }
+
+    return true;
+#else
+    status.append("Ping:        Receive ring is not supported on this platform!\n");
+    deinit();
+    return false;
+#endif
+}
+
 bool dev_ping::Impl::init()
 {
     status.clear();
@@ -294,7 +892,7 @@ bool dev_ping::Impl::deinit()
 {
     int32_t rv = 0;
     if (host_is_resolve) {
-        memset(static_cast<void *>(&m_dest_addr), 0, sizeof(sockaddr_in));
+        memset(static_cast<void *>(&m_dest_addr), 0, sizeof(m_dest_addr));
         host_is_resolve = false;
     }
     // 3 ====================================================================
@@ -318,6 +916,22 @@ bool dev_ping::Impl::deinit()
 #endif
     }
     // ====================================================================
+#ifdef __linux__
+    if (ring_map) {
+        munmap(ring_map, (size_t)RING_BLOCK_SIZE * RING_BLOCK_NR);
+        ring_map = nullptr;
+    }
+    if (ring_is_init) {
+        int32_t err = close(ring_sock);
+        if (err) {
+            status.append("Ping:        Close packet socket failed " + std::to_string(errno) +" !\n");
+            rv += -1;
+        }
+        else ring_is_init = false;
+        ring_sock = -1;
+    }
+#endif
+    // ====================================================================
 #ifdef __WIN32__
     if (wsa_is_init) {
         int err = WSACleanup();
@@ -332,33 +946,25 @@ bool dev_ping::Impl::deinit()
     return rv ? false : true;
 }
 
-bool dev_ping::Impl::send_icmp()
+int dev_ping::Impl::packet_size() const
 {
-    char *data = m_send_packet;
-#ifdef _MSC_VER
-    uint16_t pid = _getpid() & 0xFFFF;
-#else
-    uint16_t pid = getpid() & 0xFFFF;
-#endif
-	
+    return m_ping_size_payload + sizeof(ICMPHeader) + sizeof(timeval); // MTU
+}
 
-    int size = m_ping_size_payload + sizeof(ICMPHeader) + sizeof(timeval); // MTU
+template<class AF>
+int dev_ping::Impl::send_echo(uint16_t seq, uint64_t *time_send)
+{
+    char *data = m_send_packet;
+    int size = packet_size();
 
     ICMPHeader *pkt = (ICMPHeader *)data;
-    pkt->type       = ICMP_ECHO;
+    pkt->type       = AF::echo_request;
     pkt->code       = 0;
     pkt->checksum   = 0;
-    pkt->id         = htons(pid);
-    pkt->sequence   = htons(m_ping_seq_num);
-
-#ifdef __WIN32__
-    LARGE_INTEGER StartingTime;
-    QueryPerformanceCounter(&StartingTime);
-    uint64_t time = StartingTime.QuadPart;
-#else
-    uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-#endif
+    pkt->id         = htons(m_ident);
+    pkt->sequence   = htons(seq);
 
+    uint64_t time = time_now();
     memcpy(&data[sizeof(ICMPHeader)], &time, sizeof (time));
     logPrintf("tim1 %u\n", time);
 
@@ -368,9 +974,17 @@ bool dev_ping::Impl::send_icmp()
     }
 
     // compute checksum of full packet
-    pkt->checksum   = htons(compute_checksum(pkt, size));
+    pkt->checksum   = htons(AF::checksum(src_addr<AF>(), dest_addr<AF>(), pkt, size));
+
+    if (time_send) *time_send = time;
+    return (int)sendto(sock, data, size, 0, (sockaddr *)&m_dest_addr, sizeof(typename AF::sockaddr_type));
+}
 
-    int bytes = sendto(sock, data, size, 0, (sockaddr *)&m_dest_addr, sizeof(sockaddr_in));
+template<class AF>
+bool dev_ping::Impl::send_icmp()
+{
+    int size = packet_size();
+    int bytes = send_echo<AF>(m_ping_seq_num);
     if (bytes < 0) {
         status.append("Ping:        Failed to send to receiver!\n");
         deinit();
@@ -382,113 +996,87 @@ bool dev_ping::Impl::send_icmp()
         return false;
     }
 
-    char buf[128];
-    sprintf(buf, "Ping:        send: %s (id %x, seq %u, len %u)\n", inet_ntoa(m_dest_addr.sin_addr), pid, m_ping_seq_num, size);
-    status.append(buf);
+    if (m_status_text) {
+        char buf[128];
+        sprintf(buf, "Ping:        send: %s (id %x, seq %u, len %u)\n", m_dest_str.c_str(), m_ident, m_ping_seq_num, size);
+        status.append(buf);
+    }
 
     m_ping_seq_num ++;
 
     return true;
 }
 
-bool dev_ping::Impl::recv_icmp(uint32_t timeout_ms, result_t *result)
+/*  Fields of the echo send_icmp() has just sent.  */
+void dev_ping::Impl::send_result(result_t *result) const
 {
-    char *data = m_recv_packet;
-    int len = 0;
-    int maxfds = sock + 1;
-    int nfd = 0;
-    fd_set rset;
-    FD_ZERO(&rset);
-
-    socklen_t fromlen = sizeof(m_from_addr);
-
-    timeval timeout;
-    timeout.tv_sec  = timeout_ms / 1000;
-    timeout.tv_usec = (timeout_ms % 1000) * 1000;
-    logPrintf("timeout %u.%u\n", timeout.tv_sec, timeout.tv_usec);
+    if (!result) return;
+    result->to_addr     = m_dest_str;
+    result->send_id     = m_ident;
+    result->send_seq    = m_ping_seq_num - 1;
+    result->send_len    = packet_size();
+    result->send_status = status.size();
+}
 
-    int size = MAX_ICMP_SIZE;//m_ping_size_payload + sizeof(ICMPHeader) + sizeof(timeval) + sizeof (ipHeader); // MTU
+template<class AF>
+bool dev_ping::Impl::recv_icmp(uint32_t timeout_ms, result_t *result)
+{
+    const typename AF::addr_type dest = AF::addr(dest_addr<AF>());
+
+    bool done = false;
+    echo_reply<AF> got;
+    double rtt = 0;
+    auto on_reply = [&](const echo_reply<AF> &reply, uint64_t time_recv) {
+        if (!AF::same(reply.from, dest)) {
+            status.append("Ping:        Invalid address, discard!\n");
+            return;
+        }
+        if (reply.type != AF::echo_reply || reply.id != m_ident) return;
+        // late reply to an earlier echo
+        if (reply.seq != (uint16_t)(m_ping_seq_num - 1)) return;
+
+        got     = reply;
+        rtt     = time_diff(reply.time_send, time_recv);
+        logPrintf("tim2 %u\n", time_recv);
+        done    = true;
+    };
 
+    uint64_t time_start = time_now();
     int retry = 4;
-    while (retry --) {
+    while (!done && retry --) {
+        double elapsed_ms = time_diff(time_start, time_now()) * 1000;
+        uint32_t remain_ms = elapsed_ms < timeout_ms ? timeout_ms - (uint32_t)elapsed_ms : 0;
 
-        FD_SET(sock, &rset);
-        if ((nfd = select(maxfds, &rset, NULL, NULL, &timeout)) == -1) {
-            status.append("Ping:        Select error!\n");
+        int n = sock_recv<AF>(remain_ms, on_reply);
+        if (n < 0) {
+            status.append("Ping:        Receive error!\n");
             continue;
         }
-        if (nfd == 0) {
+        if (n == 0) {
             status.append("Ping:        Request timeout!\n");
             continue;
         }
+    }
 
-        if (FD_ISSET(sock, &rset)) {
-            if ((len = (int)recvfrom(sock, data, size, 0, (struct sockaddr *) &m_from_addr, &fromlen)) < 0) {
-                status.append("Ping:        Recvfrom error!\n");
-                continue;
-            }
-
-            std::string from_addr = inet_ntoa(m_from_addr.sin_addr);
-            std::string dest_addr = inet_ntoa(m_dest_addr.sin_addr);
-            if (from_addr != dest_addr) {
-                status.append("Ping:        Invalid address, discard!\n");
-                continue;
-            }
-
-            ipHeader *ip = (ipHeader *)data;
-            int iphdrlen = ip->ip_hl << 2;
-
-            len -= iphdrlen;
-            if (len < 8)  {
-                status.append("Ping:        ICMP packets\'s length is less than 8\n");
-                break;
-            }
-
-            ICMPHeader *icmp = (ICMPHeader *) (&data[iphdrlen]);
-
-            if (icmp->type == ICMP_ECHOREPLY) {
-                uint16_t id         = ntohs(icmp->id);
-                uint16_t icmpseq    = ntohs(icmp->sequence);
-                uint8_t  ttl        = ip->ip_ttl;
-                uint16_t icmp_len   = len;
-#ifdef __WIN32__
-                LARGE_INTEGER Frequency;
-                QueryPerformanceFrequency(&Frequency);
-                LARGE_INTEGER  EndingTime;
-                QueryPerformanceCounter(&EndingTime);
-                uint64_t time_recv = EndingTime.QuadPart;
-#else
-                uint64_t time_recv = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
-                logPrintf("tim2 %u\n", time_recv);
-#endif
-                uint64_t time_send;
-                memcpy(&time_send, &data[iphdrlen + sizeof (ICMPHeader)], sizeof (time_send));
-#ifdef __WIN32__
-                uint64_t time_elapsed = time_recv - time_send;
-                time_elapsed *=  1000000;
-                time_elapsed /= Frequency.QuadPart;
-                double rtt = time_elapsed / 1000000.;
-#else
-                double rtt = (time_recv - time_send) / 1000000000.;
-#endif
-
-                char buf[128];
-                sprintf(buf, "Ping:        recv: %s (id %x, seq %u, len %u, ttl %u, time %8.6f us)\n", from_addr.c_str(), id, icmpseq, icmp_len, ttl, rtt);
-                status.append(buf);
-
-                if (result) {
-                    result->icmp_id     = id;
-                    result->icmp_seq    = icmpseq;
-                    result->icmp_len    = icmp_len;
-                    result->ip_ttl      = ttl;
-                    result->rtt         = rtt;
-                    result->from_addr   = from_addr;
-                    result->status      = status;
-                }
+    std::string from_addr = addr_to_string(m_from_addr);
+    if (done) {
+        if (m_status_text) {
+            char buf[160];
+            sprintf(buf, "Ping:        recv: %s (id %x, seq %u, len %u, ttl %u, time %8.6f us)\n", from_addr.c_str(), got.id, got.seq, got.len, got.ttl, rtt);
+            status.append(buf);
+        }
 
-                return true;
-            }
+        if (result) {
+            result->icmp_id     = got.id;
+            result->icmp_seq    = got.seq;
+            result->icmp_len    = got.len;
+            result->ip_ttl      = got.ttl;
+            result->rtt         = rtt;
+            result->from_addr   = from_addr;
+            result->status      = status;
         }
+
+        return true;
     }
 
     if (result) {
@@ -497,68 +1085,274 @@ bool dev_ping::Impl::recv_icmp(uint32_t timeout_ms, result_t *result)
         result->icmp_len    = 0;
         result->ip_ttl      = 0;
         result->rtt         = 0;
-        result->from_addr   = inet_ntoa(m_from_addr.sin_addr);
+        result->from_addr   = from_addr;
         result->status      = status;
     }
     deinit();
     return false;
 }
 
-bool dev_ping::Impl::getsockaddr(const char *host, sockaddr_in *sockaddr)
+template<class AF>
+bool dev_ping::Impl::parse_reply(const char *icmp, int len, echo_reply<AF> *reply)
 {
-    memset(static_cast<void *>(sockaddr), 0, sizeof(sockaddr));
-    sockaddr->sin_family = AF_INET;
-
-    bool rc = true;
-    if (host == NULL || host[0] == '\0') {
-        sockaddr->sin_addr.s_addr = htonl(INADDR_ANY);
+    if (!icmp || len < 8) return false;
+
+    const ICMPHeader *hdr = (const ICMPHeader *)icmp;
+    reply->type     = hdr->type;
+    reply->id       = ntohs(hdr->id);
+    reply->seq      = ntohs(hdr->sequence);
+    reply->len      = len;
+    reply->time_send = 0;
+    if (len >= (int)(sizeof(ICMPHeader) + sizeof(reply->time_send))) {
+        memcpy(&reply->time_send, &icmp[sizeof (ICMPHeader)], sizeof (reply->time_send));
     }
-    else {
-        char c;
-        const char *p = host;
-        bool is_ipaddr = true;
-        while ((c = (*p++)) != '\0') {
-            if ((c != '.') && (!((c >= '0') && (c <= '9')))) {
-                is_ipaddr = false;
-                break;
-            }
-        }
+    return true;
+}
 
-        if (is_ipaddr) {
-            sockaddr->sin_addr.s_addr = inet_addr(host);
+template<class AF>
+bool dev_ping::Impl::flood_run(uint32_t window, uint32_t duration_ms, flood_result_t *result)
+{
+    std::deque<std::pair<uint16_t, uint64_t>> in_flight; // sequence number and send time, in send order
+    uint32_t outstanding = 0;
+    m_flood_sent.assign(0x10000, 0);
+
+    int size        = packet_size();
+    uint32_t sent   = 0;
+    uint32_t received = 0;
+    uint32_t received_sending = 0; // replies within the sending period
+    uint32_t send_errors = 0;
+    double rtt_min  = 0;
+    double rtt_max  = 0;
+    double rtt_sum  = 0;
+    uint64_t time_stop = 0;     // end of the sending period, pps is counted over it
+
+    // echo timeout: fixed, or srtt + 4 * rttvar (RFC 6298) kept well below the run duration,
+    // so lost echoes give their window slots back while the run goes on
+    double timeout_max = std::max<uint32_t>(std::min<uint32_t>(FLOOD_TIMEOUT_MS, duration_ms / FLOOD_TIMEOUT_RUN_DIV), FLOOD_TIMEOUT_MIN_MS) / 1000.;
+    double timeout  = m_flood_timeout_ms ? m_flood_timeout_ms / 1000. : timeout_max;
+    double srtt     = 0;
+    double rttvar   = 0;
+    double delay_max = 0;
+
+    const typename AF::addr_type dest = AF::addr(dest_addr<AF>());
+    auto on_reply = [&](const echo_reply<AF> &reply, uint64_t time_recv) {
+        if (reply.type != AF::echo_reply || reply.id != m_ident) return;
+        if (!AF::same(reply.from, dest)) return;
+        if (!m_flood_sent[reply.seq]) return; // late or duplicate
+
+        m_flood_sent[reply.seq] = 0;
+        outstanding--;
+        received++;
+
+        if (!time_stop || time_recv <= time_stop) received_sending++;
+
+        double rtt = time_diff(reply.time_send, time_recv);
+        if (received == 1 || rtt < rtt_min) rtt_min = rtt;
+        if (rtt > rtt_max) rtt_max = rtt;
+        rtt_sum += rtt;
+
+        // ring timestamps are taken on arrival, the timeout has to cover the block retire delay too
+        double delay = m_use_ring ? time_diff(reply.time_send, time_now()) : rtt;
+        if (delay > delay_max) delay_max = delay;
+        if (received == 1) {
+            srtt    = delay;
+            rttvar  = delay / 2;
         }
         else {
-            struct hostent *hostname = gethostbyname(host);
-            if (hostname != NULL) {
-                memcpy(&(sockaddr->sin_addr), *(hostname->h_addr_list), sizeof(struct in_addr));
+            rttvar  = 0.75 * rttvar + 0.25 * std::fabs(srtt - delay);
+            srtt    = 0.875 * srtt + 0.125 * delay;
+        }
+        // the first window goes out in a burst and its queueing builds up, the estimate settles after it
+        // and never drops below twice the worst delay seen: an echo expired while it is still queued frees
+        // its slot early, the queue grows and more echoes expire
+        if (!m_flood_timeout_ms && received >= window) {
+            timeout = std::max(std::max(srtt + 4 * rttvar, 2 * delay_max), FLOOD_TIMEOUT_MIN_MS / 1000.);
+            timeout = std::min(timeout, timeout_max);
+        }
+    };
+
+    uint64_t time_start = time_now();
+    for (;;) {
+        uint64_t now = time_now();
+
+        // expire the oldest echoes which were not answered in time,
+        // an entry whose slot was reused after a sequence wrap is already accounted
+        while (!in_flight.empty()) {
+            uint16_t seq = in_flight.front().first;
+            if (m_flood_sent[seq] == in_flight.front().second) {
+                if (time_diff(m_flood_sent[seq], now) < timeout) break;
+                m_flood_sent[seq] = 0;
+                outstanding--;
             }
-            else {
-                rc = false;
+            in_flight.pop_front();
+        }
+
+        bool sending = time_diff(time_start, now) * 1000 < duration_ms;
+        if (!sending && !time_stop) time_stop = now;
+        if (!sending && outstanding == 0) break;
+
+        // keep the window full, a new echo goes out as soon as a reply frees a slot
+        while (sending && outstanding < window) {
+            // sequence space wrapped within the echo timeout: the old echo can not be matched any more, it is lost
+            if (m_flood_sent[m_ping_seq_num]) {
+                m_flood_sent[m_ping_seq_num] = 0;
+                outstanding--;
             }
+
+            uint64_t time_send;
+            if (send_echo<AF>(m_ping_seq_num, &time_send) != size) {
+                send_errors++;
+                break;
+            }
+            m_flood_sent[m_ping_seq_num] = time_send;
+            in_flight.push_back(std::make_pair(m_ping_seq_num, time_send));
+            m_ping_seq_num++;
+            outstanding++;
+            sent++;
         }
+
+        int n = m_use_ring ? ring_recv<AF>(FLOOD_POLL_MS, on_reply) : sock_recv<AF>(FLOOD_POLL_MS, on_reply);
+        if (n < 0) {
+            status.append("Ping:        Receive error!\n");
+            return false;
+        }
+    }
+
+    if (sent == 0) {
+        status.append("Ping:        Failed to send to receiver!\n");
+        return false;
     }
-    return rc;
+    if (send_errors) {
+        status.append("Ping:        Flood window " + std::to_string(window) + ", send errors " + std::to_string(send_errors) + "\n");
+    }
+
+    result->window      = window;
+    result->sent        = sent;
+    result->received    = received;
+    result->elapsed     = time_diff(time_start, time_stop);
+    result->pps         = result->elapsed > 0 ? received_sending / result->elapsed : 0;
+    result->loss        = (sent - received) * 100. / sent;
+    result->rtt_min     = rtt_min;
+    result->rtt_avg     = received ? rtt_sum / received : 0;
+    result->rtt_max     = rtt_max;
+    result->rtt_inflation = 0;
+    return true;
 }
 
-uint16_t dev_ping::Impl::compute_checksum(const void *packet, int size)
+template<class AF, class F>
+int dev_ping::Impl::sock_recv(uint32_t timeout_ms, F on_reply)
 {
-    const uint8_t *packet_bytes = static_cast<const uint8_t *>(packet);
-    uint32_t sum = 0;
+    fd_set rset;
+    FD_ZERO(&rset);
+    FD_SET(sock, &rset);
 
-    for (int i = 0; i < size; i++) {
-        if ((i & 1) == 0) {
-            sum += packet_bytes[i] << 8;
-        } else {
-            sum += packet_bytes[i];
+    timeval timeout;
+    timeout.tv_sec  = timeout_ms / 1000;
+    timeout.tv_usec = (timeout_ms % 1000) * 1000;
+
+    int nfd = select(sock + 1, &rset, NULL, NULL, &timeout);
+    if (nfd <= 0) return nfd;
+
+    int len;
+    int hoplimit = 0;
+#ifdef __WIN32__
+    socklen_t fromlen = sizeof(m_from_addr);
+    len = (int)recvfrom(sock, m_recv_packet, MAX_ICMP_SIZE, 0, (struct sockaddr *) &m_from_addr, &fromlen);
+#else
+    iovec iov;
+    iov.iov_base    = m_recv_packet;
+    iov.iov_len     = MAX_ICMP_SIZE;
+
+    char control[128];
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name        = &m_from_addr;
+    msg.msg_namelen     = sizeof(m_from_addr);
+    msg.msg_iov         = &iov;
+    msg.msg_iovlen      = 1;
+    msg.msg_control     = control;
+    msg.msg_controllen  = sizeof(control);
+
+    len = (int)recvmsg(sock, &msg, 0);
+#ifdef IPV6_HOPLIMIT
+    if (len >= 0) {
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_HOPLIMIT) {
+                memcpy(&hoplimit, CMSG_DATA(cmsg), sizeof(hoplimit));
+            }
         }
     }
+#endif
+#endif
+    if (len < 0) return -1;
+    uint64_t time_recv = time_now();
+
+    echo_reply<AF> reply;
+    const typename AF::sockaddr_type &from = *reinterpret_cast<const typename AF::sockaddr_type *>(&m_from_addr);
+    const char *icmp = AF::parse_socket(m_recv_packet, &len, from, hoplimit, &reply.from, &reply.ttl);
+    if (parse_reply<AF>(icmp, len, &reply)) on_reply(reply, time_recv);
+    return 1;
+}
 
-    /* Sums which overflow a 16-bit value have the high bits added back into the low 16 bits. */
-    while (sum >> 16) {
-        sum = (sum >> 16) + (sum & 0xffff);
+template<class AF, class F>
+int dev_ping::Impl::ring_recv(uint32_t timeout_ms, F on_reply)
+{
+#ifdef __linux__
+    tpacket_block_desc *block = (tpacket_block_desc *)(ring_map + (size_t)ring_block * RING_BLOCK_SIZE);
+    if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+        pollfd pfd;
+        pfd.fd      = ring_sock;
+        pfd.events  = POLLIN | POLLERR;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, timeout_ms) < 0) return errno == EINTR ? 0 : -1;
+        if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) return 0;
     }
 
-    /* The value stored is the one's complement of the mathematical sum. */
-    return (~sum & 0xffff);
+    // the whole block is parsed in place, packets start at the network header
+    uint32_t num_pkts = block->hdr.bh1.num_pkts;
+    const uint8_t *pkt = (const uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+    for (uint32_t i = 0; i < num_pkts; i++) {
+        const tpacket3_hdr *hdr = (const tpacket3_hdr *)pkt;
+        uint64_t time_recv = (uint64_t)hdr->tp_sec * 1000000000ull + hdr->tp_nsec + ring_clock_offset;
+
+        echo_reply<AF> reply;
+        int len = (int)hdr->tp_snaplen;
+        const char *icmp = AF::parse_network((const char *)pkt + hdr->tp_net, &len, &reply.from, &reply.ttl);
+        if (parse_reply<AF>(icmp, len, &reply)) on_reply(reply, time_recv);
+
+        pkt += hdr->tp_next_offset;
+    }
+
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    ring_block = (ring_block + 1) % RING_BLOCK_NR;
+    return (int)num_pkts;
+#else
+    (void)timeout_ms;
+    (void)on_reply;
+    return -1;
+#endif
 }
 
+bool dev_ping::Impl::getsockaddr(const char *host, sockaddr_storage *sockaddr)
+{
+    memset(static_cast<void *>(sockaddr), 0, sizeof(*sockaddr));
+
+    if (host == NULL || host[0] == '\0') {
+        sockaddr_in *sin = (sockaddr_in *)sockaddr;
+        sin->sin_family = AF_INET;
+        sin->sin_addr.s_addr = htonl(INADDR_ANY);
+        return true;
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = m_family_pref;
+
+    addrinfo *res = NULL;
+    if (getaddrinfo(host, NULL, &hints, &res) != 0 || res == NULL) {
+        return false;
+    }
+    memcpy(sockaddr, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    return true;
+}
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 class dev_ping {
 public:
@@ -10,6 +11,12 @@ public:
     dev_ping(const std::string &hostname);
     virtual ~dev_ping();
 
+    typedef enum {
+        FAMILY_ANY,     // first address the resolver returns
+        FAMILY_INET,    // IPv4 only
+        FAMILY_INET6,   // IPv6 only
+    } family_t;
+
     typedef struct result_s {
         uint16_t    icmp_id;    // id proccess
         uint16_t    icmp_seq;   // sequence number
@@ -17,12 +24,40 @@ public:
         uint8_t     ip_ttl;     // time to live
         double      rtt;        // round trip time
         std::string from_addr;  // ip addres of host
+        std::string to_addr;    // ip addres echo was sent to
+        uint16_t    send_id;    // id sent
+        uint16_t    send_seq;   // sequence number sent
+        uint16_t    send_len;   // lenght of sent icmp packet, 0 - not sent
+        size_t      send_status; // lenght of status when the echo was sent, send line goes there
         std::string status;     // status string of result
     } result_t;
 
+    typedef struct flood_result_s {
+        uint32_t    window;     // echoes kept in flight
+        uint32_t    sent;       // echo requests sent
+        uint32_t    received;   // matched echo replies
+        double      elapsed;    // sending period of the run, sec
+        double      pps;        // achieved replies per second
+        double      loss;       // lost echoes, percent
+        double      rtt_min;    // round trip time min
+        double      rtt_avg;    // round trip time average
+        double      rtt_max;    // round trip time max
+        double      rtt_inflation; // rtt_avg relative to an unloaded window 1 run
+    } flood_result_t;
+
     bool check(const std::string &hostname, result_t *result = nullptr);
     bool check(result_t *result = nullptr);
+    // window 0 - auto-tune: double the window while pps grows
+    bool flood(uint32_t window, uint32_t duration_ms, std::vector<flood_result_t> *results = nullptr, std::string *status = nullptr);
     void setSize(uint16_t size);
+    // flood replies from AF_PACKET TPACKET_V3 ring (Linux only),
+    // replies come in blocks retired every 1 ms, auto-tune starts from window 256
+    void setRecvRing(bool enable);
+    // flood echo without reply is lost after timeout_ms, 0 - adaptive from rtt (default)
+    void setFloodTimeout(uint32_t timeout_ms);
+    // false - send/recv lines are not formatted into status, result fields only
+    void setStatusText(bool enable);
+    void setFamily(family_t family);
 
 private:
     class Impl;
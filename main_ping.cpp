@@ -1,5 +1,13 @@
 #include <cstdio>
+#include <cctype>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "device_ping.h"
+#include "output_pipe.h"
+
+#define OUTPUT_QUEUE_MAX (64 * 1024) // records per target queue
 
 #ifndef _MSC_VER
 	#include <getopt.h>
@@ -80,11 +88,23 @@ int
  */
 void display_usage(void)
 {
-    printf("Usage: pinghr destination\n");
+    printf("Usage: pinghr destination [destination ...]\n");
     printf("\t-h --help         - print help\n");
 
+    printf("\t-4                - IPv4 only\n");
+    printf("\t-6                - IPv6 only\n");
+
     printf("\t-s                - packetsize\n");
     printf("\t-f                - fragmentation off\n");
+    printf("\t-F                - flood, keep a window of echoes in flight\n");
+    printf("\t-W                - flood window, 0 - auto-tune (default)\n");
+    printf("\t-T                - flood run duration per window, ms (default 1000)\n");
+    printf("\t-E                - flood echo timeout, ms, 0 - adaptive from rtt (default)\n");
+    printf("\t-R                - flood replies from packet ring (Linux), pps is capped at about window * 1000\n");
+    printf("\t-c                - count of echoes, 0 - infinite (default 1)\n");
+    printf("\t-i                - interval between echoes, ms (default 1000)\n");
+    printf("\t-Q                - output queue depth, up to %u (default 1024)\n", OUTPUT_QUEUE_MAX);
+    printf("\t-O                - full output queue policy: block (default), drop, sample[:N]\n");
 }
 
 int main(int argc, char *argv[])
@@ -96,11 +116,22 @@ int main(int argc, char *argv[])
         display_usage();
         return -1;
     }
-    const char *short_options = {"hs:f"}; // x: - mean x have parametr
+    const char *short_options = {"h46s:fFW:T:E:Rc:i:Q:O:"}; // x: - mean x have parametr
 
-    std::string addr;
+    std::vector<std::string> targets;
+    dev_ping::family_t family = dev_ping::FAMILY_ANY;
     uint32_t packetsize = 0;
     bool fragmentation = false;
+    bool flood = false;
+    uint32_t flood_window = 0;
+    uint32_t flood_duration = 1000;
+    uint32_t flood_timeout = 0;
+    bool recv_ring = false;
+    uint32_t count = 1;
+    uint32_t interval = 1000;
+    uint32_t queue_depth = 1024;
+    output_pipe::policy_t policy = output_pipe::POLICY_BLOCK;
+    uint32_t sample_rate = 10;
 
     int opt;
     do {
@@ -111,6 +142,14 @@ int main(int argc, char *argv[])
                 return 0;
             } break;
 
+            case '4': {
+                family = dev_ping::FAMILY_INET;
+            } break;
+
+            case '6': {
+                family = dev_ping::FAMILY_INET6;
+            } break;
+
             case 's': {
                 if (optarg) {
                     sscanf(optarg, "%u", &packetsize);
@@ -122,21 +161,141 @@ int main(int argc, char *argv[])
                 printf("\t fragmentation off by default (TODO)\n");
             } break;
 
+            case 'F': {
+                flood = true;
+            } break;
+
+            case 'W': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &flood_window);
+                    printf("\t flood window %u\n", flood_window);
+                }
+            } break;
+
+            case 'T': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &flood_duration);
+                    printf("\t flood duration %u ms\n", flood_duration);
+                }
+            } break;
+
+            case 'E': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &flood_timeout);
+                    printf("\t flood echo timeout %u ms\n", flood_timeout);
+                }
+            } break;
+
+            case 'R': {
+                recv_ring = true;
+            } break;
+
+            case 'c': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &count);
+                    printf("\t count %u\n", count);
+                }
+            } break;
+
+            case 'i': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &interval);
+                    printf("\t interval %u ms\n", interval);
+                }
+            } break;
+
+            case 'Q': {
+                if (optarg) {
+                    sscanf(optarg, "%u", &queue_depth);
+                    if (queue_depth > OUTPUT_QUEUE_MAX) queue_depth = OUTPUT_QUEUE_MAX;
+                    printf("\t output queue depth %u\n", queue_depth);
+                }
+            } break;
+
+            case 'O': {
+                if (optarg) {
+                    std::string arg(optarg);
+                    unsigned rate = 0;
+                    char tail;
+                    if (arg == "block") policy = output_pipe::POLICY_BLOCK;
+                    else if (arg == "drop") policy = output_pipe::POLICY_DROP;
+                    else if (arg == "sample") policy = output_pipe::POLICY_SAMPLE;
+                    else if (arg.compare(0, 7, "sample:") == 0 && isdigit((unsigned char)optarg[7])
+                          && sscanf(optarg + 7, "%u%c", &rate, &tail) == 1 && rate > 0) {
+                        policy = output_pipe::POLICY_SAMPLE;
+                        sample_rate = rate;
+                    }
+                    else {
+                        printf("\t unknown output policy '%s'\n", optarg);
+                        return -1;
+                    }
+                    printf("\t output policy %s\n", optarg);
+                }
+            } break;
+
             default: {
-                printf("\t ping '%s'\n", argv[optind]);
-                addr.assign(argv[optind]);
             } break;
         }
     } while (opt != -1);
 
-    if (addr.empty()) return -2;
+    for (int i = optind; i < argc; i++) {
+        printf("\t ping '%s'\n", argv[i]);
+        targets.push_back(argv[i]);
+    }
+    if (targets.empty()) return -2;
+
+    output_pipe out(targets, queue_depth, policy, sample_rate);
+    std::atomic<int> rv {0};
+
+    // every target is probed by its own thread into its own output queue
+    auto probe = [&](size_t t) {
+        dev_ping p(targets[t]);
+        p.setFamily(family);
+        if (packetsize) p.setSize(packetsize);
+
+        if (flood) {
+            p.setRecvRing(recv_ring);
+            p.setFloodTimeout(flood_timeout);
+            std::vector<dev_ping::flood_result_t> flood_results;
+            output_record_t head;
+            head.kind   = output_record_t::FLOOD_HEAD;
+            head.ok     = p.flood(flood_window, flood_duration, &flood_results, &head.status);
+            bool ok     = head.ok;
+            out.push(t, std::move(head));
+            for (const auto &r : flood_results) {
+                output_record_t rec;
+                rec.kind    = output_record_t::FLOOD_RUN;
+                rec.ok      = true;
+                rec.run     = r;
+                out.push(t, std::move(rec));
+            }
+            if (!ok) rv = -3;
+        }
+        else {
+            // output thread formats the echo lines
+            p.setStatusText(false);
+            auto next = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; count == 0 || i < count; i++) {
+                if (i) {
+                    next += std::chrono::milliseconds(interval);
+                    std::this_thread::sleep_until(next);
+                }
+                output_record_t rec;
+                rec.kind    = output_record_t::ECHO;
+                rec.ok      = p.check(&rec.echo);
+                rec.status  = std::move(rec.echo.status);
+                out.push(t, std::move(rec));
+            }
+        }
+    };
+
+    std::vector<std::thread> probes;
+    for (size_t t = 0; t < targets.size(); t++) {
+        probes.emplace_back(probe, t);
+    }
+    for (auto &th : probes) th.join();
 
-    dev_ping p;
-    dev_ping::result_t ping_result;
-    if (packetsize) p.setSize(packetsize);
-    bool ok = p.check(addr, &ping_result);
-    printf("Ping: %s\n", ok ? "ok" : "fail");
-    printf("%s", ping_result.status.c_str());
+    out.stop();
 
-    return 0;
+    return rv;
 }
@@ -0,0 +1,148 @@
+#include "output_pipe.h"
+
+#include <chrono>
+#include <cstdio>
+
+output_pipe::output_pipe(const std::vector<std::string> &names, size_t depth, policy_t policy, uint32_t sample_rate)
+    : m_policy(policy)
+    , m_sample_rate(sample_rate ? sample_rate : 1)
+{
+    for (const auto &name : names) {
+        m_producers.push_back(std::make_unique<producer_t>(name, depth));
+    }
+    m_thread = std::thread(&output_pipe::run, this);
+}
+
+output_pipe::~output_pipe()
+{
+    stop();
+}
+
+void output_pipe::push(size_t producer, output_record_t &&record)
+{
+    producer_t &p = *m_producers[producer];
+    // the sampled record goes first to keep the order
+    if (p.has_sample && p.queue.push(std::move(p.sample))) p.has_sample = false;
+    if (!p.has_sample && p.queue.push(std::move(record))) return;
+
+    p.full++;
+    switch (m_policy) {
+        case POLICY_BLOCK: {
+            while (!p.queue.push(std::move(record))) {
+                std::this_thread::yield();
+            }
+        } break;
+
+        case POLICY_SAMPLE: {
+            if (p.full % m_sample_rate == 0) {
+                if (p.has_sample) p.dropped.store(p.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                p.sample        = std::move(record);
+                p.has_sample    = true;
+                break;
+            }
+            p.dropped.store(p.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } break;
+
+        case POLICY_DROP: {
+            p.dropped.store(p.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } break;
+    }
+}
+
+uint64_t output_pipe::dropped() const
+{
+    uint64_t dropped = 0;
+    for (const auto &p : m_producers) dropped += p->dropped.load(std::memory_order_relaxed);
+    return dropped;
+}
+
+void output_pipe::report_dropped(uint64_t *reported) const
+{
+    uint64_t total = dropped();
+    if (total == *reported) return;
+    printf("Output: %llu records dropped\n", (unsigned long long)total);
+    fflush(stdout);
+    *reported = total;
+}
+
+void output_pipe::stop()
+{
+    if (!m_thread.joinable()) return;
+    // producers are done, their sampled records are the last ones
+    for (const auto &p : m_producers) {
+        while (p->has_sample && !p->queue.push(std::move(p->sample))) {
+            std::this_thread::yield();
+        }
+        p->has_sample = false;
+    }
+    m_stop.store(true, std::memory_order_release);
+    m_thread.join();
+}
+
+void output_pipe::run()
+{
+    output_record_t record;
+    uint64_t reported = 0;
+    auto report_next = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    for (;;) {
+        // drops are reported while running too, a run with -c 0 may never stop cleanly
+        auto now = std::chrono::steady_clock::now();
+        if (now >= report_next) {
+            report_dropped(&reported);
+            report_next = now + std::chrono::seconds(1);
+        }
+
+        bool stop = m_stop.load(std::memory_order_acquire);
+        bool idle = true;
+        for (const auto &p : m_producers) {
+            if (p->queue.pop(record)) {
+                print(*p, record);
+                idle = false;
+            }
+        }
+        if (!idle) continue;
+        // producers were done before the last pass, so it has flushed what was left
+        if (stop) break;
+
+        fflush(stdout);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    report_dropped(&reported);
+    fflush(stdout);
+}
+
+void output_pipe::print(const producer_t &producer, const output_record_t &record) const
+{
+    switch (record.kind) {
+        case output_record_t::ECHO: {
+            const dev_ping::result_t &r = record.echo;
+            printf("Ping: %s\n", record.ok ? "ok" : "fail");
+            // send line keeps its place among the status lines
+            size_t send_status = r.send_len && r.send_status <= record.status.size() ? r.send_status : record.status.size();
+            printf("%.*s", (int)send_status, record.status.c_str());
+            if (r.send_len) {
+                printf("Ping:        send: %s (id %x, seq %u, len %u)\n",
+                       r.to_addr.c_str(), r.send_id, r.send_seq, r.send_len);
+            }
+            printf("%s", record.status.c_str() + send_status);
+            if (record.ok) {
+                printf("Ping:        recv: %s (id %x, seq %u, len %u, ttl %u, time %8.6f us)\n",
+                       r.from_addr.c_str(), r.icmp_id, r.icmp_seq, r.icmp_len, r.ip_ttl, r.rtt);
+            }
+        } break;
+
+        case output_record_t::FLOOD_HEAD: {
+            printf("Flood: %s\n", record.ok ? "ok" : "fail");
+            printf("%s", record.status.c_str());
+            printf("Flood: %8s %10s %10s %8s %12s %30s %9s\n", "window", "sent", "recv", "loss,%", "pps", "rtt min/avg/max, ms", "inflation");
+        } break;
+
+        case output_record_t::FLOOD_RUN: {
+            const dev_ping::flood_result_t &r = record.run;
+            printf("Flood: %8u %10u %10u %8.2f %12.1f %10.3f/%9.3f/%9.3f %9.2f%s%s\n",
+                   r.window, r.sent, r.received, r.loss, r.pps,
+                   r.rtt_min * 1000, r.rtt_avg * 1000, r.rtt_max * 1000, r.rtt_inflation,
+                   m_producers.size() > 1 ? " " : "", m_producers.size() > 1 ? producer.name.c_str() : "");
+        } break;
+    }
+}
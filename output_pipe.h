@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_ping.h"
+#include "spsc_queue.h"
+
+typedef struct output_record_s {
+    enum kind_e {
+        ECHO,           // single echo, status + echo
+        FLOOD_HEAD,     // flood summary, status
+        FLOOD_RUN,      // one flood window, run
+    } kind;
+    bool        ok;
+    std::string status;
+    dev_ping::result_t          echo;
+    dev_ping::flood_result_t    run;
+} output_record_t;
+
+/*!
+ * \brief The output_pipe class
+ *
+ * Every probing thread (producer) pushes result records into its own bounded SPSC queue,
+ * a dedicated output thread drains all queues, formats and writes records to stdout.
+ * A full queue never stalls probing longer than the policy allows.
+ */
+class output_pipe {
+public:
+    enum policy_t {
+        POLICY_BLOCK,   // wait for a free slot
+        POLICY_DROP,    // drop the record and count it
+        POLICY_SAMPLE,  // drop, but keep every sample_rate-th record aside until the next push, never wait
+    };
+
+    // one producer per name, names label flood runs when there are several
+    output_pipe(const std::vector<std::string> &names, size_t depth, policy_t policy, uint32_t sample_rate = 10);
+    virtual ~output_pipe();
+
+    // from the producer thread only
+    void push(size_t producer, output_record_t &&record);
+    // after producers are done: drain the queues and join the output thread
+    void stop();
+
+    uint64_t dropped() const;
+
+private:
+    typedef struct producer_s {
+        producer_s(const std::string &name, size_t depth) : name(name), queue(depth) {}
+        std::string name;
+        spsc_queue<output_record_t> queue;
+        uint64_t    full = 0;       // pushes into a full queue
+        std::atomic<uint64_t> dropped {0}; // written by producer, reported by output thread
+        output_record_t sample;     // POLICY_SAMPLE record waiting for a free slot
+        bool        has_sample = false;
+    } producer_t;
+
+    void run();
+    void report_dropped(uint64_t *reported) const;
+    void print(const producer_t &producer, const output_record_t &record) const;
+
+    std::vector<std::unique_ptr<producer_t>> m_producers;
+    policy_t    m_policy;
+    uint32_t    m_sample_rate;
+    std::atomic<bool> m_stop {false};
+    std::thread m_thread;
+
+private:
+    output_pipe(const output_pipe&) = delete;
+    output_pipe& operator=(const output_pipe&) = delete;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/*!
+ * \brief Bounded lock-free single-producer/single-consumer queue
+ *
+ * Only one thread may call push() and only one other thread may call pop().
+ * Capacity is rounded up to a power of two.
+ */
+template<class T>
+class spsc_queue {
+public:
+    explicit spsc_queue(size_t capacity)
+        : m_items(round_up(capacity))
+        , m_mask(m_items.size() - 1)
+    {
+    }
+
+    // false - queue is full, item is untouched
+    bool push(T &&item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head_cache > m_mask) {
+            m_head_cache = m_head.load(std::memory_order_acquire);
+            if (tail - m_head_cache > m_mask) return false;
+        }
+        m_items[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false - queue is empty
+    bool pop(T &item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail_cache) {
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tail_cache) return false;
+        }
+        item = std::move(m_items[head & m_mask]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return m_items.size(); }
+
+private:
+    static size_t round_up(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    // producer and consumer positions live on separate cache lines
+    enum { CACHE_LINE = 64 };
+
+    std::vector<T> m_items;
+    const size_t m_mask;
+    char m_pad0[CACHE_LINE];
+    std::atomic<size_t> m_tail {0};     // written by producer
+    size_t m_head_cache = 0;            // producer copy of m_head
+    char m_pad1[CACHE_LINE];
+    std::atomic<size_t> m_head {0};     // written by consumer
+    size_t m_tail_cache = 0;            // consumer copy of m_tail
+    char m_pad2[CACHE_LINE];
+
+private:
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+};
@@ -0,0 +1,88 @@
+#include <cstdio>
+#include <cstdint>
+#include <thread>
+
+#include "spsc_queue.h"
+
+#define CHECK(x) \
+    do { \
+        if (!(x)) { \
+            printf("Fail line %u: '%s'\n", __LINE__, #x); \
+            return false; \
+        } \
+    } while(0)
+
+/*  One thread: capacity rounding, full and empty queue, order across the wrap.  */
+static bool test_single()
+{
+    spsc_queue<uint32_t> queue(5);
+    CHECK(queue.capacity() == 8);
+
+    uint32_t item;
+    CHECK(!queue.pop(item));
+
+    // every round starts 3 slots further, so positions wrap the rounded capacity many times
+    uint32_t next_push = 0;
+    uint32_t next_pop = 0;
+    for (int round = 0; round < 100; round++) {
+        for (size_t i = 0; i < queue.capacity(); i++) {
+            CHECK(queue.push(uint32_t(next_push++)));
+        }
+        uint32_t extra = next_push;
+        CHECK(!queue.push(std::move(extra)));
+
+        for (int i = 0; i < 5; i++) {
+            CHECK(queue.pop(item));
+            CHECK(item == next_pop++);
+        }
+        for (int i = 0; i < 2; i++) {
+            CHECK(queue.push(uint32_t(next_push++)));
+        }
+        while (queue.pop(item)) {
+            CHECK(item == next_pop++);
+        }
+        CHECK(next_pop == next_push);
+    }
+    return true;
+}
+
+/*  Producer and consumer threads: every item arrives once and in order.  */
+static bool test_threads()
+{
+    const uint32_t count = 1000000;
+    spsc_queue<uint32_t> queue(1000);
+
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t item = i;
+            while (!queue.push(std::move(item))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t received = 0;
+    bool ordered = true;
+    uint32_t item;
+    while (received < count) {
+        if (!queue.pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item != received) ordered = false;
+        received++;
+    }
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(received == count);
+    CHECK(!queue.pop(item));
+    return true;
+}
+
+int main()
+{
+    bool ok = test_single() && test_threads();
+    printf("spsc_queue: %s\n", ok ? "ok" : "fail");
+    return ok ? 0 : 1;
+}